@@ -0,0 +1,86 @@
+// Copyright 2009, Joe Tsai. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE.md file.
+
+/*
+Description:
+    The coin count log that the door button keeps in its data EEPROM. Every
+    press appends a record to a ring of slots that spans the whole data
+    EEPROM, which spreads the wear evenly over all cells. Each record is a
+    coin count followed by a sequence stamp.
+    This file is compiled into both door_button.c and the log_sim program.
+    Before including it, each must define log_byte as an 8-bit unsigned type
+    and declare these functions:
+        log_byte EEPROM_Read(log_byte addr); // Read a byte
+        void log_write(log_byte addr, log_byte value); // Start writing a byte
+        void log_wait(); // Wait for a started write to complete
+*/
+
+
+/* Helper macros */
+#define LOG_SLOTS 64 // Two byte records fill the 128 byte data EEPROM
+#define LOG_COUNT(slot) (2*(slot)+0) // Address of the coin count
+#define LOG_SEQ(slot) (2*(slot)+1) // Address of the sequence stamp
+
+
+/* Global variables */
+log_byte log_slot;
+log_byte log_seq;
+
+
+// Locate the most recent record in the data EEPROM and return the coin
+// count from it. The most recent record is the one that continues the
+// sequence of its predecessor, but is not continued by its successor.
+// Records where the count was written, but not the sequence stamp, never
+// continue the sequence and are ignored. If no record is found, such as on
+// a blank EEPROM, then counting starts from zero in the first slot.
+log_byte log_recover() {
+    log_byte scan;
+    log_byte prev_seq;
+    log_byte this_seq;
+    log_byte next_seq;
+    log_byte count;
+
+    log_slot = LOG_SLOTS-1;
+    prev_seq = EEPROM_Read(LOG_SEQ(LOG_SLOTS-1));
+    this_seq = EEPROM_Read(LOG_SEQ(0));
+    for (scan = 0; scan < LOG_SLOTS; scan++) {
+        if (scan == LOG_SLOTS-1) {
+            next_seq = EEPROM_Read(LOG_SEQ(0));
+        } else {
+            next_seq = EEPROM_Read(LOG_SEQ(scan+1));
+        }
+
+        if (this_seq == (log_byte)(prev_seq+1) &&
+            next_seq != (log_byte)(this_seq+1)) {
+            log_slot = scan;
+            break;
+        }
+
+        prev_seq = this_seq;
+        this_seq = next_seq;
+    }
+    log_seq = EEPROM_Read(LOG_SEQ(log_slot));
+
+    // Erased cells read as 0xFF, so treat any invalid count as zero
+    count = EEPROM_Read(LOG_COUNT(log_slot));
+    if (count > 99) {
+        count = 0;
+    }
+    return count;
+}
+
+
+// Append the coin count to the next slot. The count is written before the
+// sequence stamp so that losing power part way through leaves the previous
+// record as the most recent one. The stamp is still being written on return.
+void log_append(log_byte count) {
+    log_slot++;
+    if (log_slot == LOG_SLOTS) {
+        log_slot = 0;
+    }
+    log_seq++;
+    log_write(LOG_COUNT(log_slot), count);
+    log_wait();
+    log_write(LOG_SEQ(log_slot), log_seq);
+}
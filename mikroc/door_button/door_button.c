@@ -15,6 +15,8 @@ Description:
     Since this component is placed outside the door as the button interface, as
     few components as possible were used to reduce cost in the unfortunate event
     that someone stole the doorbell button.
+    The coin count is kept in the on-chip data EEPROM so that it survives a
+    loss of power, using the wear-leveled log in coin_log.h.
 Configuration:
     Microcontroller:   PIC16F628A
     Oscillator:        INT_RC, 4.00 MHz
@@ -31,6 +33,17 @@ Notes:
 */
 
 
+/* Coin count log */
+typedef unsigned short log_byte;
+void log_write(log_byte addr, log_byte value);
+void log_wait();
+#include "coin_log.h"
+
+
+/* Helper macros */
+#define LOG_WRITE_MS 10 // Worst case data EEPROM write time, rounded up
+
+
 /* Global constants */
 const unsigned short LO_SEGMENT[10] = {
     0x02, 0xDA, 0x44, 0x50, 0x98, 0x11, 0x01, 0x5A, 0x00, 0x10,
@@ -80,8 +93,37 @@ void interrupt() {
 }
 
 
+// Start writing a byte to the data EEPROM without waiting for the write to
+// complete. The write takes several milliseconds to finish in the background,
+// so log_wait must be called between successive writes.
+void log_write(log_byte addr, log_byte value) {
+    while (EECON1.WR); // Wait for any previous write
+
+    EEADR = addr;
+    EEDATA = value;
+    EECON1.WREN = 1; // Enable writes
+
+    // Required unlock sequence, which must not be interrupted
+    INTCON.GIE = 0;
+    EECON2 = 0x55;
+    EECON2 = 0xAA;
+    EECON1.WR = 1;
+    INTCON.GIE = 1;
+
+    EECON1.WREN = 0; // Disable writes, the current write still completes
+}
+
+
+// Wait for a data EEPROM write to complete.
+void log_wait() {
+    delay_ms(LOG_WRITE_MS);
+}
+
+
 // Main routine
 void main() {
+    unsigned short count;
+
     // Define settings
     PORTA = 0x00;
     PORTB = 0x00;
@@ -91,8 +133,9 @@ void main() {
     OPTION_REG = 0x04;
 
     // Initialize variables
-    hi_num = 0;
-    lo_num = 0;
+    count = log_recover();
+    hi_num = count / 10;
+    lo_num = count % 10;
     toggle = 0;
     press = 0;
 
@@ -143,11 +186,15 @@ void main() {
                 soft_uart_write(ring_type);
                 INTCON.GIE = 1;
 
-                // Set delay until next allowable button press
+                // Log the count to the next slot
+                log_append(10*hi_num + lo_num);
+
+                // Set delay until next allowable button press, which also
+                // covers the sequence stamp that is still being written
                 switch (ring_type) {
-                case COIN:          delay_ms(125); break;
-                case COIN_1UP:      delay_ms(675); break;
-                case COIN_MUSHROOM: delay_ms(875); break;
+                case COIN:          delay_ms(125 - LOG_WRITE_MS); break;
+                case COIN_1UP:      delay_ms(675 - LOG_WRITE_MS); break;
+                case COIN_MUSHROOM: delay_ms(875 - LOG_WRITE_MS); break;
                 }
             }
 
@@ -0,0 +1,77 @@
+// Copyright 2009, Joe Tsai. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE.md file.
+
+/*
+Description:
+    The attack cache of the door ringer, which holds the first few samples of
+    the most played sounds in RAM. The CACHE_ sizes and tables are copied from
+    the plan that hex_convert prints into eeprom.log.
+    This file is compiled into both door_ringer.c and the cache_check program.
+    Before including it, each must define cache_byte as an 8-bit unsigned type
+    and cache_addr as a 32-bit unsigned type, and declare these functions:
+        void cache_read_start(cache_addr addr); // Start reading the EEPROM
+        cache_byte cache_read(); // Read the next byte from the EEPROM
+        void cache_read_stop(); // Stop reading the EEPROM
+*/
+
+
+/* Helper macros */
+#define CACHE_CLIPS 3 // Number of sounds in the attack cache
+#define CACHE_BYTES 12 // Total size of the attack cache
+
+
+/* Global constants */
+const cache_addr CACHE_OFFSET[CACHE_CLIPS] = {
+    0x000000, 0x0046BE, 0x0089AE,
+};
+const cache_byte CACHE_LENGTH[CACHE_CLIPS] = {
+    4, 4, 4,
+};
+
+
+/* Global variables */
+cache_byte cache_data[CACHE_BYTES];
+cache_byte cache_pos; // Index in cache_data of the sound found by cache_lookup
+cache_byte cache_len; // Number of cached bytes of that sound, or zero
+cache_byte cache_last; // Index of the last cached byte of that sound
+
+
+// Load the cached bytes of every sound from the EEPROM, which must be awake.
+void cache_load() {
+    cache_byte scan;
+    cache_byte pos;
+    cache_byte end;
+
+    pos = 0;
+    for (scan = 0; scan < CACHE_CLIPS; scan++) {
+        end = pos + CACHE_LENGTH[scan];
+        cache_read_start(CACHE_OFFSET[scan]);
+        for (; pos < end; pos++) {
+            cache_data[pos] = cache_read();
+        }
+        cache_read_stop();
+    }
+}
+
+
+// Find the cached bytes of the sound at offset. Sounds shorter than their
+// cached bytes are played from the EEPROM alone. Returns the EEPROM address
+// of the first byte that is not cached, which is where streaming continues.
+cache_addr cache_lookup(cache_addr offset, cache_addr length) {
+    cache_byte scan;
+
+    cache_pos = 0;
+    cache_len = 0;
+    for (scan = 0; scan < CACHE_CLIPS; scan++) {
+        if (CACHE_OFFSET[scan] == offset) {
+            if (CACHE_LENGTH[scan] <= length) {
+                cache_len = CACHE_LENGTH[scan];
+            }
+            break;
+        }
+        cache_pos += CACHE_LENGTH[scan];
+    }
+    cache_last = cache_len - 1;
+    return offset + cache_len;
+}
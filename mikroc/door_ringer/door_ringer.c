@@ -21,14 +21,38 @@ Notes:
     into a single Intel Hex file ready to load onto the EEPROM chip. Only 8-bit,
     monophonic, non-compressed wav files are playable. In addition, only rates
     of 8000, 11025, and 22050 samples/second are supported.
+    Playback statistics are kept in the tm struct and are sent as a single
+    frame on the USART whenever the TM_REQUEST byte is received. A frame is
+    the TM_SYNC byte, the payload length, the payload, and a checksum that
+    makes the sum of the length and payload bytes zero. The ring_report
+    program decodes captured frames. Timer1 runs at 1.25 MHz to time playback.
+    The boot count is kept in the data EEPROM so that the ring_report program
+    can tell which frames came from the same run of the ringer.
+    To hide the EEPROM power-up delay, the first few samples of the most
+    played sounds are loaded into RAM at boot. Those samples are played while
+    the EEPROM wakes up, after which the EEPROM is read from the first sample
+    that was not cached. The hex_convert program lists which sounds to cache
+    for a given RAM budget, which are copied into the CACHE_ tables in
+    attack_cache.h.
 */
 
 
+/* Attack cache */
+typedef unsigned short cache_byte;
+typedef unsigned long cache_addr;
+void cache_read_start(cache_addr addr);
+cache_byte cache_read();
+void cache_read_stop();
+#include "attack_cache.h"
+
+
 /* Helper macros */
 #define BYTE0(param) ((char *)&param)[0]
 #define BYTE1(param) ((char *)&param)[1]
 #define BYTE2(param) ((char *)&param)[2]
 #define BYTE3(param) ((char *)&param)[3]
+#define TM_SYNC 0xA5 // Start of a telemetry frame
+#define TM_REQUEST 0x3F // Received byte that requests a telemetry frame
 
 
 /* Global constants */
@@ -36,13 +60,29 @@ enum frequency { FREQ_8000, FREQ_11025, FREQ_22050 };
 enum sound { COIN, COIN_1UP, COIN_MUSHROOM, ITS_MARIO, OUTTA_TIME, DOWN_PIPE };
 
 
+/* Struct definitions */
+typedef struct {
+    unsigned int boots; // Number of times the ringer has started up
+    unsigned int rings[6]; // Rings played per sound
+    unsigned int preempts; // Sounds stopped early by a received byte
+    unsigned int dropped; // Received bytes overwritten before being played
+    unsigned int overruns; // Samples that took longer than the sample period
+    unsigned int wake_last; // Timer1 ticks from wake up to the read command
+    unsigned int wake_max; // Largest wake_last seen
+} Telemetry;
+
+
 /* Global variables */
 unsigned short rx_data;
 unsigned long wave_scan;
+unsigned short tm_request;
+Telemetry tm;
 
 
 // Interrupt vector
 void interrupt() {
+    unsigned short _rx_data;
+
     // If there is an external interrupt
     if (INTCON.INTF) {
         delay_ms(25); // Debounce delay
@@ -62,16 +102,44 @@ void interrupt() {
 
     // If there is an unread byte
     if (PIR1.RCIF) {
-        rx_data = usart_read();
-        wave_scan = 0x80000000; // Stop on-going sounds
+        _rx_data = usart_read();
+        if (_rx_data == TM_REQUEST) {
+            tm_request = 1;
+        } else {
+            if (rx_data != 0xFF) {
+                tm.dropped++; // Previous byte was never played
+            }
+            rx_data = _rx_data;
+            wave_scan = 0x80000000; // Stop on-going sounds
+        }
     }
 }
 
 
-// Function to play sound from the EEPROM
-void play_sound(short rate, unsigned long offset, unsigned long length) {
-    unsigned int wave_data;
+// Function to start reading the EEPROM at the given address
+void cache_read_start(cache_addr addr) {
+    PORTC.F0 = 0;
+    spi_write(0x03); // EEPROM read command
+    spi_write(BYTE2(addr));
+    spi_write(BYTE1(addr));
+    spi_write(BYTE0(addr));
+}
+
+
+// Function to read the next byte from the EEPROM
+cache_byte cache_read() {
+    return SPI_Read(0x00);
+}
+
+
+// Function to stop reading the EEPROM
+void cache_read_stop() {
+    PORTC.F0 = 1;
+}
+
 
+// Function to load the attack cache from the EEPROM
+void load_cache() {
     // Wake up EEPROM - with power-up delay
     PORTC.F0 = 1;
     PORTC.F0 = 0;
@@ -79,16 +147,145 @@ void play_sound(short rate, unsigned long offset, unsigned long length) {
     PORTC.F0 = 1;
     delay_us(100);
 
-    // Setup the EEPROM
+    // Read the first samples of each cached sound
+    cache_load();
+
+    // Shutdown EEPROM - with power-down delay
     PORTC.F0 = 0;
-    PORTC.F2 = 1; // Unhold EEPROM
-    spi_write(0x03); // EEPROM read command
-    spi_write(BYTE2(offset));
-    spi_write(BYTE1(offset));
-    spi_write(BYTE0(offset));
+    spi_write(0xB9);
+    PORTC.F0 = 1;
+    delay_us(100);
+}
+
+
+// Function to record the time from EEPROM wake up to the read command, which
+// is the time in Timer1 plus the given ticks counted before it was restarted
+void record_wake(unsigned int ticks) {
+    // Stop Timer1 so that TMR1L cannot roll over between the reads
+    T1CON.TMR1ON = 0;
+    BYTE0(tm.wake_last) = TMR1L;
+    BYTE1(tm.wake_last) = TMR1H;
+    T1CON.TMR1ON = 1;
+
+    tm.wake_last += ticks;
+    if (tm.wake_last > tm.wake_max) {
+        tm.wake_max = tm.wake_last;
+    }
+}
+
+
+// Function to play sound from the EEPROM
+void play_sound(short rate, unsigned long offset, unsigned long length) {
+    unsigned int wave_data;
+    unsigned short max_ticks;
+    unsigned int ticks;
+    unsigned int wake_ticks;
+
+    // Set the longest allowed sample period with 25% slack, in Timer1 ticks
+    switch (rate) {
+        case FREQ_8000:  max_ticks = 195; break;
+        case FREQ_11025: max_ticks = 142; break;
+        case FREQ_22050: max_ticks = 71;  break;
+    }
+
+    // Find the cached samples for this sound, and stream from the first
+    // byte that is not cached
+    offset = cache_lookup(offset, length);
+
+    // Start timing the wake up
+    TMR1H = 0;
+    TMR1L = 0;
+    wake_ticks = 0;
+
+    // Wake up EEPROM
+    PORTC.F0 = 1;
+    PORTC.F0 = 0;
+    spi_write(0xAB);
+    PORTC.F0 = 1;
+
+    // Process cached bytes, which last at least the EEPROM power-up delay
+    for (wave_scan = 0x000000; wave_scan < cache_len; wave_scan++) {
+        // Check whether the previous sample took too long, then restart
+        // Timer1. Timer1 is stopped while it is read, and the ticks are
+        // added up to time the wake up until the read command.
+        T1CON.TMR1ON = 0;
+        BYTE0(ticks) = TMR1L;
+        BYTE1(ticks) = TMR1H;
+        TMR1L = 0;
+        TMR1H = 0;
+        T1CON.TMR1ON = 1;
+        if (ticks > max_ticks) {
+            tm.overruns++;
+        }
+        wake_ticks += ticks;
+
+        // Retrieve a byte of audio data
+        wave_data = (cache_data[cache_pos + BYTE0(wave_scan)] << 4);
+
+        // Write audio data to DAC
+        PORTC.F1 = 0;
+        spi_write(BYTE1(wave_data) | 0x10);
+        spi_write(BYTE0(wave_data));
+        PORTC.F1 = 1;
+
+        if (BYTE0(wave_scan) != cache_last) {
+            // Set delays for different sampling rates, plus the time that
+            // a streamed byte spends reading the EEPROM (about 3 us), less
+            // the longer overrun check (about 2 us)
+            switch (rate) {
+                case FREQ_8000:  delay_us(0x64); break;
+                case FREQ_11025: delay_us(0x40); break;
+                case FREQ_22050: delay_us(0x11); break;
+            }
+        } else {
+            // Setup the EEPROM to continue after the cached bytes. The
+            // EEPROM has powered up by now, since hex_convert caches one
+            // byte more than the power-up delay lasts.
+            PORTC.F0 = 0;
+            PORTC.F2 = 1; // Unhold EEPROM
+            spi_write(0x03); // EEPROM read command
+            spi_write(BYTE2(offset));
+            spi_write(BYTE1(offset));
+            spi_write(BYTE0(offset));
+            record_wake(wake_ticks);
+
+            // Set delays as above, less the read command and recording the
+            // wake up (about 15 us)
+            switch (rate) {
+                case FREQ_8000:  delay_us(0x55); break;
+                case FREQ_11025: delay_us(0x31); break;
+                case FREQ_22050: delay_us(0x02); break;
+            }
+        }
+    }
+
+    // Setup the EEPROM if nothing was cached - with power-up delay
+    if (cache_len == 0) {
+        delay_us(100);
+        PORTC.F0 = 0;
+        PORTC.F2 = 1; // Unhold EEPROM
+        spi_write(0x03); // EEPROM read command
+        spi_write(BYTE2(offset));
+        spi_write(BYTE1(offset));
+        spi_write(BYTE0(offset));
+        record_wake(0);
+
+        // Do not count the power-up delay as an overrun
+        TMR1L = 0;
+        TMR1H = 0;
+    }
+
+    // Process remaining bytes in sound file
+    for (; wave_scan < length; wave_scan++) {
+        // Check whether the previous sample took too long, then restart
+        // Timer1. TMR1L is read first, so stalls of 256 ticks or more are
+        // always seen in TMR1H.
+        if (TMR1L > max_ticks || TMR1H) {
+            tm.overruns++;
+        }
+        TMR1L = 0;
+        TMR1H = 0;
 
-    // Process all bytes in sound file
-    for (wave_scan = 0x000000; wave_scan < length; wave_scan++) {
         // Retrieve a byte of audio data
         PORTC.F2 = 1; // Unhold EEPROM
         wave_data = (SPI_Read(0x00) << 4); // Read EEPROM byte
@@ -100,13 +297,16 @@ void play_sound(short rate, unsigned long offset, unsigned long length) {
         spi_write(BYTE0(wave_data));
         PORTC.F1 = 1;
 
-        // Set delays for different sampling rates
+        // Set delays for different sampling rates, less the overrun check
         switch (rate) {
-            case FREQ_8000:  delay_us(0x65); break;
-            case FREQ_11025: delay_us(0x41); break;
-            case FREQ_22050: delay_us(0x12); break;
+            case FREQ_8000:  delay_us(0x63); break;
+            case FREQ_11025: delay_us(0x3F); break;
+            case FREQ_22050: delay_us(0x10); break;
         }
     }
+    if (BYTE3(wave_scan) & 0x80) {
+        tm.preempts++;
+    }
 
     // Set DAC voltage output to normalized level
     PORTC.F1 = 0;
@@ -123,13 +323,45 @@ void play_sound(short rate, unsigned long offset, unsigned long length) {
 }
 
 
+// Function to send the telemetry frame on the USART
+void send_telemetry() {
+    unsigned short scan;
+    unsigned short checksum;
+    char *payload;
+
+    payload = (char *)&tm;
+    checksum = sizeof(tm);
+    usart_write(TM_SYNC);
+    usart_write(sizeof(tm));
+    for (scan = 0; scan < sizeof(tm); scan++) {
+        checksum += payload[scan];
+        usart_write(payload[scan]);
+    }
+    usart_write(~checksum + 1);
+}
+
+
 // Main routine
 void main() {
     unsigned short _rx_data;
+    unsigned short scan;
 
     // Initiate variables
     rx_data = 0xFF;
     wave_scan = 0xFFFFFFFF;
+    tm_request = 0;
+    for (scan = 0; scan < sizeof(tm); scan++) {
+        ((char *)&tm)[scan] = 0;
+    }
+
+    // Count this boot in the data EEPROM
+    BYTE0(tm.boots) = EEPROM_Read(0x00);
+    BYTE1(tm.boots) = EEPROM_Read(0x01);
+    tm.boots++;
+    EEPROM_Write(0x00, BYTE0(tm.boots));
+    delay_ms(20);
+    EEPROM_Write(0x01, BYTE1(tm.boots));
+    delay_ms(20);
 
     // Disable ADC modules
     ANSEL = 0x00;
@@ -138,6 +370,9 @@ void main() {
     TRISA = 0x07;
     WPUA = 0x07;
 
+    // Setup Timer1 at Fosc/4 with 1:4 prescaler
+    T1CON = 0x21;
+
     // Setup SPI module
     TRISB = 0x00;
     TRISC = 0x00;
@@ -150,6 +385,7 @@ void main() {
     spi_init_advanced(
         MASTER_OSC_DIV4, DATA_SAMPLE_MIDDLE, CLK_IDLE_LOW, LOW_2_HIGH
     );
+    load_cache();
 
     // Setup USART module with interrupts
     usart_init(9615);
@@ -160,8 +396,19 @@ void main() {
 
     // Continue forever
     while (1) {
+        if (tm_request) {
+            tm_request = 0;
+            send_telemetry();
+        }
+
+        // Take the wave to play, so that no byte is received in between
+        INTCON.GIE = 0;
         _rx_data = rx_data;
         rx_data = 0xFF; // Clear the wave to play
+        INTCON.GIE = 1;
+        if (_rx_data <= DOWN_PIPE) {
+            tm.rings[_rx_data]++;
+        }
         switch (_rx_data) {
         case COIN:
             play_sound(FREQ_22050, 0x000000, 0x0046BE);
@@ -0,0 +1,381 @@
+// Copyright 2009, Joe Tsai. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE.md file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+
+/* Attack cache */
+typedef uint8_t cache_byte;
+typedef uint32_t cache_addr;
+void cache_read_start(cache_addr addr);
+cache_byte cache_read();
+void cache_read_stop();
+#include "../door_ringer/attack_cache.h"
+
+
+/* Helper macros */
+#define BYTE0(param) ((uint8_t)(param))
+#define EEPROM_SIZE 0x20000
+#define EEPROM_WAKE_US 100 // Power-up delay of the EEPROM on the door ringer
+#define MAX_CLIPS 16
+#define MAX_CALLS 64
+#define NO_READ -1
+#define NO_PREEMPT 0xFFFFFFFF
+
+
+/* Struct definitions */
+typedef struct {
+    int      num_clips;
+    int      clips; // Number of sounds printed as CACHE_CLIPS
+    int      bytes; // Total size printed as CACHE_BYTES
+    uint32_t offset[MAX_CLIPS];
+    uint32_t length[MAX_CLIPS];
+} CachePlan;
+
+typedef struct {
+    uint32_t rate;
+    uint32_t offset;
+    uint32_t length;
+    uint32_t preempt_at;
+} PlayCall;
+
+
+/* Global variables */
+uint8_t eeprom[EEPROM_SIZE];
+int64_t read_addr = NO_READ; // Next EEPROM address read, if reading
+CachePlan plan;
+PlayCall play_calls[MAX_CALLS];
+int num_calls;
+
+
+/* Global constants */
+const char help_msg[] = (
+    "This program checks the attack cache of the door ringer. It loads the\n"
+    "EEPROM image and the cache plan from the hex_convert output, and checks\n"
+    "that the CACHE_ tables in attack_cache.h match the plan. It then loads\n"
+    "the cache and replays every play_sound call found in door_ringer.c, plus\n"
+    "preempted and short versions of each cached sound, using the cache_load\n"
+    "and cache_lookup functions of attack_cache.h and a model of the playback\n"
+    "loops of play_sound. The replayed samples must match the EEPROM exactly,\n"
+    "and the EEPROM must not be read before it has woken up.\n"
+    "Usage: cache_check eeprom.hex eeprom.log door_ringer.c\n\n"
+);
+
+
+int load_hexfile(const char* filename);
+int load_plan(const char* filename);
+int check_tables();
+int load_calls(const char* filename);
+int add_call(uint32_t rate, uint32_t offset, uint32_t length,
+    uint32_t preempt_at);
+int play_sound(const PlayCall* call, uint8_t* out, uint32_t* out_len);
+
+
+int main(int argc, char* argv[]) {
+    if (argc != 4) {
+        printf(help_msg);
+        return -1;
+    }
+
+    if (load_hexfile(argv[1]) || load_plan(argv[2]) || check_tables() ||
+        load_calls(argv[3]))
+        return -1;
+
+    // Load the cache the same way as load_cache in door_ringer.c
+    cache_load();
+
+    // Replay each sound and compare it with the EEPROM
+    uint8_t* out = malloc(EEPROM_SIZE);
+    if (out == NULL) {
+        printf("Memory error\n");
+        return -1;
+    }
+    for (int scan = 0; scan < num_calls; scan++) {
+        const PlayCall* call = &play_calls[scan];
+        uint32_t out_len = 0;
+        if (play_sound(call, out, &out_len)) {
+            free(out);
+            return -1;
+        }
+
+        uint32_t want_len = call->length;
+        if (call->preempt_at < want_len)
+            want_len = call->preempt_at+1;
+        if (out_len != want_len ||
+            memcmp(out, &eeprom[call->offset], want_len)) {
+            printf("Sound at 0x%06X of 0x%X bytes: "
+                "replay does not match the EEPROM\n",
+                call->offset, call->length);
+            if (call->preempt_at != NO_PREEMPT)
+                printf("    Preempted after sample %u\n", call->preempt_at);
+            free(out);
+            return -1;
+        }
+    }
+    free(out);
+
+    printf("Replayed %d sounds sample-exact\n", num_calls);
+    return 0;
+}
+
+
+// Start reading the EEPROM image at addr, as the read command does.
+void cache_read_start(cache_addr addr) {
+    read_addr = addr;
+}
+
+
+// Read the next byte from the EEPROM image.
+cache_byte cache_read() {
+    if (read_addr == NO_READ || read_addr >= EEPROM_SIZE) {
+        printf("EEPROM read without a read command\n");
+        exit(-1);
+    }
+    return eeprom[read_addr++];
+}
+
+
+// Stop reading the EEPROM image.
+void cache_read_stop() {
+    read_addr = NO_READ;
+}
+
+
+// Load the Intel Hex file written by hex_convert into the EEPROM image.
+int load_hexfile(const char* filename) {
+    FILE* in = fopen(filename, "r");
+    if (in == NULL) {
+        printf("Could not open hex file\n");
+        return -1;
+    }
+
+    char line[128];
+    uint32_t bank = 0;
+    memset(eeprom, 0xFF, sizeof(eeprom));
+    while (fgets(line, sizeof(line), in) != NULL) {
+        unsigned int count, addr, type, value;
+        if (sscanf(line, ":%2x%4x%2x", &count, &addr, &type) != 3)
+            continue;
+        if (type == 0x04 && sscanf(&line[9], "%4x", &value) == 1)
+            bank = value << 16;
+        if (type != 0x00)
+            continue;
+        for (int scan = 0; scan < count; scan++) {
+            if (sscanf(&line[9+2*scan], "%2x", &value) != 1 ||
+                bank+addr+scan >= EEPROM_SIZE) {
+                printf("Hex file record error\n");
+                fclose(in);
+                return -1;
+            }
+            eeprom[bank+addr+scan] = value;
+        }
+    }
+    fclose(in);
+    return 0;
+}
+
+
+// Load the attack cache plan printed by hex_convert into its log.
+int load_plan(const char* filename) {
+    FILE* in = fopen(filename, "r");
+    if (in == NULL) {
+        printf("Could not open log file\n");
+        return -1;
+    }
+
+    char line[128];
+    bool in_plan = false;
+    plan.num_clips = 0;
+    plan.clips = -1;
+    plan.bytes = -1;
+    while (fgets(line, sizeof(line), in) != NULL) {
+        int wav_idx;
+        unsigned int offset, length;
+        if (strncmp(line, "Attack cache:", 13) == 0)
+            in_plan = true;
+        else if (in_plan && plan.num_clips < MAX_CLIPS &&
+            sscanf(line, " Wave %d: 0x%x, %u bytes",
+                &wav_idx, &offset, &length) == 3) {
+            plan.offset[plan.num_clips] = offset;
+            plan.length[plan.num_clips] = length;
+            plan.num_clips++;
+        } else if (in_plan) {
+            sscanf(line, " #define CACHE_CLIPS %d", &plan.clips);
+            sscanf(line, " #define CACHE_BYTES %d", &plan.bytes);
+        }
+    }
+    fclose(in);
+
+    if (plan.num_clips == 0) {
+        printf("No attack cache in log file\n");
+        return -1;
+    }
+    if (plan.clips < 0 || plan.bytes < 0) {
+        printf("No attack cache sizes in log file\n");
+        return -1;
+    }
+    return 0;
+}
+
+
+// Check that the CACHE_ tables and sizes in attack_cache.h match the plan,
+// and that the cache holds exactly the bytes listed in CACHE_LENGTH.
+int check_tables() {
+    if (plan.clips != plan.num_clips || CACHE_CLIPS != plan.clips) {
+        printf("CACHE_CLIPS does not match the plan in the log\n");
+        return -1;
+    }
+    int bytes = 0;
+    for (int scan = 0; scan < CACHE_CLIPS; scan++)
+        bytes += CACHE_LENGTH[scan];
+    if (CACHE_BYTES != plan.bytes || CACHE_BYTES != bytes) {
+        printf("CACHE_BYTES does not match the plan in the log\n");
+        return -1;
+    }
+    for (int scan = 0; scan < plan.num_clips; scan++) {
+        if (CACHE_OFFSET[scan] != plan.offset[scan]) {
+            printf("CACHE_OFFSET does not match the plan in the log\n");
+            return -1;
+        }
+        if (CACHE_LENGTH[scan] != plan.length[scan]) {
+            printf("CACHE_LENGTH does not match the plan in the log\n");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+// Load the play_sound calls made by the door ringer source. Each cached sound
+// is then also played preempted after each of its cached bytes and a little
+// later, and cut short to lengths around its cached bytes.
+int load_calls(const char* filename) {
+    FILE* in = fopen(filename, "r");
+    if (in == NULL) {
+        printf("Could not open door ringer source\n");
+        return -1;
+    }
+
+    char line[256];
+    num_calls = 0;
+    while (fgets(line, sizeof(line), in) != NULL) {
+        char rate_name[16];
+        unsigned int offset, length;
+        if (sscanf(line, " play_sound(FREQ_%15[0-9], 0x%x, 0x%x)",
+            rate_name, &offset, &length) != 3)
+            continue;
+        uint32_t rate = strtoul(rate_name, NULL, 10);
+        if (add_call(rate, offset, length, NO_PREEMPT)) {
+            fclose(in);
+            return -1;
+        }
+    }
+    fclose(in);
+
+    int num_source = num_calls;
+    if (num_source == 0) {
+        printf("No play_sound calls in door ringer source\n");
+        return -1;
+    }
+    for (int clip = 0; clip < CACHE_CLIPS; clip++) {
+        const PlayCall* call = NULL;
+        for (int scan = 0; scan < num_source; scan++) {
+            if (play_calls[scan].offset == CACHE_OFFSET[clip]) {
+                call = &play_calls[scan];
+                break;
+            }
+        }
+        if (call == NULL) {
+            printf("Cached sound at 0x%06X is never played\n",
+                CACHE_OFFSET[clip]);
+            return -1;
+        }
+
+        uint32_t len = CACHE_LENGTH[clip];
+        for (uint32_t at = 0; at <= len; at++) {
+            if (add_call(call->rate, call->offset, call->length, at))
+                return -1;
+        }
+        if (add_call(call->rate, call->offset, call->length, 100) ||
+            add_call(call->rate, call->offset, 1, NO_PREEMPT) ||
+            (len > 1 &&
+                add_call(call->rate, call->offset, len-1, NO_PREEMPT)) ||
+            add_call(call->rate, call->offset, len, NO_PREEMPT) ||
+            add_call(call->rate, call->offset, len+1, NO_PREEMPT))
+            return -1;
+    }
+    return 0;
+}
+
+
+// Add a sound to the list of sounds to replay.
+int add_call(uint32_t rate, uint32_t offset, uint32_t length,
+    uint32_t preempt_at) {
+    if (num_calls == MAX_CALLS) {
+        printf("Too many sounds to replay\n");
+        return -1;
+    }
+    if (rate == 0 || length == 0 || offset+length > EEPROM_SIZE) {
+        printf("Sound at 0x%06X of 0x%X bytes is not in the EEPROM\n",
+            offset, length);
+        return -1;
+    }
+    PlayCall* call = &play_calls[num_calls++];
+    call->rate = rate;
+    call->offset = offset;
+    call->length = length;
+    call->preempt_at = preempt_at;
+    return 0;
+}
+
+
+// Replay a sound the same way as play_sound in door_ringer.c, writing the
+// samples sent to the DAC into out. The interrupt that preempts a sound is
+// taken right after the sample at preempt_at is written to the DAC. Time is
+// kept in whole sample periods, which is enough to check that the EEPROM is
+// only read after it has woken up.
+int play_sound(const PlayCall* call, uint8_t* out, uint32_t* out_len) {
+    uint32_t offset = call->offset;
+    uint32_t length = call->length;
+    uint32_t wave_scan;
+    double wake_us = 0;
+
+    // Find the cached samples for this sound, and stream from the first
+    // byte that is not cached
+    offset = cache_lookup(offset, length);
+
+    // Process cached bytes
+    for (wave_scan = 0; wave_scan < cache_len; wave_scan++) {
+        out[(*out_len)++] = cache_data[cache_pos + BYTE0(wave_scan)];
+        if (wave_scan == call->preempt_at)
+            wave_scan = 0x80000000;
+
+        if (BYTE0(wave_scan) == cache_last) {
+            if (wake_us < EEPROM_WAKE_US) {
+                printf("Sound at 0x%06X: EEPROM read %.1f us after wake up\n",
+                    call->offset, wake_us);
+                return -1;
+            }
+            cache_read_start(offset);
+        }
+        wake_us += 1e6 / call->rate;
+    }
+
+    // Setup the EEPROM if nothing was cached
+    if (cache_len == 0)
+        cache_read_start(offset);
+
+    // Process remaining bytes in sound file
+    for (; wave_scan < length; wave_scan++) {
+        out[(*out_len)++] = cache_read();
+        if (wave_scan == call->preempt_at)
+            wave_scan = 0x80000000;
+    }
+    cache_read_stop();
+    return 0;
+}
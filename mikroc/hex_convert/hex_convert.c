@@ -14,6 +14,7 @@
 #define FUNC_RETURN(fn, rc) { fn(); return rc; }
 #define FUNC_PRINT_RETURN(fn, st, rc) { fn(); printf(st); return rc; }
 #define IS_POWER_2(d) (((d) & ((d)-1)) == 0)
+#define EEPROM_WAKE_US 100 // Power-up delay of the EEPROM on the door ringer
 
 
 /* Struct definitions */
@@ -47,17 +48,30 @@ typedef struct {
     size_t  buf_cnt;
 } HexFile;
 
+typedef struct {
+    size_t   offset;
+    size_t   length;
+    uint32_t sample_rate;
+    uint32_t weight;
+    size_t   cache_len;
+} WaveInfo;
+
 
 /* Global constants */
 const char help_msg[] = (
     "This program will generate an Intel Hex file containing the sound data\n"
     "from a series of wave files. Only monophonic sounds at rates of 8000,\n"
     "11025, or 22050 samples per second are supported.\n\n"
+    "A wave file may be followed by a colon and a play weight, such as\n"
+    "coin.wav:100, to make it a candidate for the attack cache on the door\n"
+    "ringer. The cache is sized with -r followed by the RAM budget in bytes.\n\n"
 );
 
 
 int get_input(char*** _wav_files, int* _num_files);
-int process_wavfile(HexFile* hf, const char* wav_file, int wav_idx);
+int process_wavfile(HexFile* hf, const char* wav_file, int wav_idx,
+    WaveInfo* info);
+void plan_cache(WaveInfo* infos, int num_files, size_t budget);
 HexFile* hexfile_open(const char* filename);
 size_t hexfile_tell(HexFile* hf);
 int hexfile_write(HexFile* hf, void* buf, size_t size);
@@ -67,26 +81,40 @@ int hexfile_close(HexFile* hf);
 int main(int argc, char* argv[]) {
     int scan;
     int num_files = 0;
+    int arg_idx = 1;
+    size_t budget = 0;
     char** wav_files = NULL;
+    WaveInfo* wav_infos = NULL;
     HexFile* hex_file = NULL;
     void ret_func() {
         hexfile_close(hex_file);
-        if (argc <= 1) {
+        free(wav_infos);
+        if (argc <= arg_idx) {
             for (scan = 0; scan < num_files; scan++)
                 free(wav_files[scan]);
             free(wav_files);
         }
     }
 
+    // Get the RAM budget for the attack cache
+    if (argc > 2 && strcmp(argv[1], "-r") == 0) {
+        budget = strtoul(argv[2], NULL, 0);
+        arg_idx = 3;
+    }
+
     // Get list of wave files to read
-    if (argc > 1) {
-        wav_files = &argv[1];
-        num_files = argc-1;
+    if (argc > arg_idx) {
+        wav_files = &argv[arg_idx];
+        num_files = argc-arg_idx;
     } else {
         if (get_input(&wav_files, &num_files))
             FUNC_RETURN(ret_func, -1);
     }
 
+    wav_infos = calloc(num_files, sizeof(WaveInfo));
+    if (wav_infos == NULL)
+        FUNC_PRINT_RETURN(ret_func, "Memory error\n", -1);
+
     // Open the Intel HEX file
     hex_file = hexfile_open("eeprom.hex");
     if (hex_file == NULL)
@@ -95,8 +123,9 @@ int main(int argc, char* argv[]) {
     // Process each wave file
     printf("Begin processing...\n\n");
     for (scan = 0; scan < num_files; scan++)
-        if (process_wavfile(hex_file, wav_files[scan], scan))
+        if (process_wavfile(hex_file, wav_files[scan], scan, &wav_infos[scan]))
             FUNC_RETURN(ret_func, -1);
+    plan_cache(wav_infos, num_files, budget);
     printf("Finish processing...\n");
 
     // Close the Intel HEX file
@@ -163,8 +192,10 @@ int get_input(char*** _wav_files, int* _num_files) {
 
 
 // Opens wav_file, parses it as a WAVE file, and then dumps the
-// sound samples into hex_file.
-int process_wavfile(HexFile* hex_file, const char* wav_file, int wav_idx) {
+// sound samples into hex_file. The location and format of the
+// samples are reported in info.
+int process_wavfile(HexFile* hex_file, const char* wav_file, int wav_idx,
+    WaveInfo* info) {
     WaveHeader wav_hdr;
     FormatChunk fmt_chk;
     DataChunk data_chk;
@@ -172,16 +203,29 @@ int process_wavfile(HexFile* hex_file, const char* wav_file, int wav_idx) {
     int fsize = 0;
     FILE* fwave = NULL;
     void* buf = NULL;
+    char* name = NULL;
     void ret_func() {
         if (fwave != NULL)
             fclose(fwave);
         free(buf);
+        free(name);
+    }
+
+    // Split off the play weight, if any
+    name = strdup(wav_file);
+    if (name == NULL)
+        FUNC_PRINT_RETURN(ret_func, "Memory error\n", -1);
+    info->weight = 0;
+    char* sep = strrchr(name, ':');
+    if (sep != NULL && isdigit(sep[1])) {
+        info->weight = strtoul(&sep[1], NULL, 10);
+        *sep = '\0';
     }
 
-    printf("Wave %d: %s\n    ", wav_idx, wav_file);
+    printf("Wave %d: %s\n    ", wav_idx, name);
 
     // Open wave file
-    fwave = fopen(wav_file, "rb");
+    fwave = fopen(name, "rb");
     if (fwave == NULL)
         FUNC_PRINT_RETURN(ret_func, "Could not open file\n", -1);
 
@@ -256,12 +300,68 @@ int process_wavfile(HexFile* hex_file, const char* wav_file, int wav_idx) {
     printf("Data offset: 0x%08X\n    ", (int)offset);
     printf("Data length: 0x%08X\n    ", data_chk.chunk_size);
     printf("Sample rate: %d\n    ", fmt_chk.sample_rate);
+    printf("Play weight: %d\n    ", info->weight);
     printf("\n");
 
+    info->offset = offset;
+    info->length = data_chk.chunk_size;
+    info->sample_rate = fmt_chk.sample_rate;
+    info->cache_len = 0;
+
     FUNC_RETURN(ret_func, 0);
 }
 
 
+// Choose the waves whose first samples the door ringer keeps in RAM, so that
+// playback can start while the EEPROM wakes up. A wave only benefits if enough
+// samples are cached to cover the EEPROM power-up delay, plus the last cached
+// sample, during which the read command is sent. Caching more than that
+// gains nothing. Waves are considered from the highest play weight down
+// and are cached if their samples still fit within the budget. The plan is
+// printed along with the sizes to copy into attack_cache.h.
+void plan_cache(WaveInfo* infos, int num_files, size_t budget) {
+    int scan;
+    size_t used = 0;
+    bool* done = calloc(num_files, sizeof(bool));
+    if (done == NULL)
+        return;
+
+    while (true) {
+        // Find the heaviest wave not yet considered
+        int best = -1;
+        for (scan = 0; scan < num_files; scan++)
+            if (!done[scan] && infos[scan].weight > 0 &&
+                (best < 0 || infos[scan].weight > infos[best].weight))
+                best = scan;
+        if (best < 0)
+            break;
+        done[best] = true;
+
+        WaveInfo* info = &infos[best];
+        size_t need = (
+            (info->sample_rate*EEPROM_WAKE_US + 999999) / 1000000 + 1
+        );
+        if (need <= info->length && used+need <= budget) {
+            info->cache_len = need;
+            used += need;
+        }
+    }
+    free(done);
+
+    int clips = 0;
+    printf("Attack cache: %d of %d bytes\n    ", (int)used, (int)budget);
+    for (scan = 0; scan < num_files; scan++)
+        if (infos[scan].cache_len > 0) {
+            printf("Wave %d: 0x%08X, %d bytes\n    ", scan,
+                (int)infos[scan].offset, (int)infos[scan].cache_len);
+            clips++;
+        }
+    printf("#define CACHE_CLIPS %d\n    ", clips);
+    printf("#define CACHE_BYTES %d\n    ", (int)used);
+    printf("\n");
+}
+
+
 // Allocate a struct to manage writing the hex file.
 HexFile* hexfile_open(const char* filename) {
     HexFile* hf = malloc(sizeof(HexFile));
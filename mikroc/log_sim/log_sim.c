@@ -0,0 +1,243 @@
+// Copyright 2009, Joe Tsai. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE.md file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+
+/* Coin count log */
+typedef uint8_t log_byte;
+log_byte EEPROM_Read(log_byte addr);
+void log_write(log_byte addr, log_byte value);
+void log_wait();
+#include "../door_button/coin_log.h"
+
+
+/* Helper macros */
+#define EEPROM_SIZE 128
+#define EEPROM_ENDURANCE 100000 // Minimum erase/write cycles per cell
+#define NO_TEAR -1
+#define NUM_PRESSES 10000000
+#define LOSS_PERIOD 1000 // Average number of presses between power losses
+
+
+/* Global variables */
+int coin_count; // Count shown on the display
+uint8_t eeprom[EEPROM_SIZE];
+uint64_t wear[EEPROM_SIZE];
+int torn_addr = NO_TEAR;
+uint8_t torn_value;
+bool power_lost;
+uint32_t rand_state = 1;
+
+
+/* Global constants */
+const char help_msg[] = (
+    "This program simulates the coin count log that the door button keeps in\n"
+    "its data EEPROM. It checks that the count is recovered after power is\n"
+    "lost during any write, and that the writes are spread evenly over the\n"
+    "EEPROM. It exits with a non-zero status on any failure.\n\n"
+);
+
+
+void boot();
+bool press_button(int addr, uint8_t value);
+void log_erase();
+uint32_t next_rand();
+int check_torn_writes();
+int check_endurance();
+
+
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        printf(help_msg);
+        return -1;
+    }
+
+    if (check_torn_writes())
+        return -1;
+    if (check_endurance())
+        return -1;
+    printf("All checks passed\n");
+    return 0;
+}
+
+
+// Read a byte from the simulated data EEPROM.
+log_byte EEPROM_Read(log_byte addr) {
+    return eeprom[addr];
+}
+
+
+// Write a byte to the simulated data EEPROM and account for the wear. Once
+// power is lost, the write to torn_addr leaves torn_value in the cell and no
+// further writes happen.
+void log_write(log_byte addr, log_byte value) {
+    if (power_lost)
+        return;
+    if (addr == torn_addr) {
+        value = torn_value;
+        power_lost = true;
+    }
+    eeprom[addr] = value;
+    wear[addr]++;
+}
+
+
+// Writes in the simulated data EEPROM complete immediately.
+void log_wait() {
+}
+
+
+// Power up and restore the count from the log, as door_button.c does.
+void boot() {
+    torn_addr = NO_TEAR;
+    power_lost = false;
+    coin_count = log_recover();
+}
+
+
+// Count a press and log it, as door_button.c does. If addr is the address
+// of one of the two writes, then power is lost during that write, which
+// leaves value in the cell. Returns whether the press was fully logged.
+bool press_button(int addr, uint8_t value) {
+    coin_count = (coin_count+1) % 100;
+    torn_addr = addr;
+    torn_value = value;
+    log_append(coin_count);
+    return !power_lost;
+}
+
+
+// Erase the simulated EEPROM and boot from it.
+void log_erase() {
+    memset(eeprom, 0xFF, sizeof(eeprom));
+    memset(wear, 0, sizeof(wear));
+    boot();
+}
+
+
+// Simple linear congruential generator, so that runs are repeatable.
+uint32_t next_rand() {
+    rand_state = rand_state*1103515245 + 12345;
+    return rand_state >> 16;
+}
+
+
+// Lose power during each write of a press, leaving every possible byte in
+// the cell, for rings that are fresh, partly filled, and wrapped several
+// times. The count must be recovered as the previous count, unless the torn
+// stamp happens to hold the correct value, in which case the count byte was
+// already written and the new count is recovered. Of note is a stamp of 0xFE
+// on a fresh ring, where the stamp of the following erased slot continues it.
+// Afterwards, logging must carry on normally from the recovered count.
+int check_torn_writes() {
+    int presses, value, write;
+    uint8_t saved[EEPROM_SIZE];
+
+    for (presses = 0; presses < 3*LOG_SLOTS; presses++) {
+        log_erase();
+        for (int scan = 0; scan < presses; scan++)
+            press_button(NO_TEAR, 0);
+        memcpy(saved, eeprom, sizeof(eeprom));
+        uint8_t slot = (log_slot+1) % LOG_SLOTS;
+        uint8_t seq = log_seq+1;
+
+        for (write = 0; write < 2; write++) {
+            for (value = 0; value <= 0xFF; value++) {
+                memcpy(eeprom, saved, sizeof(eeprom));
+                boot();
+                int addr = write ? LOG_SEQ(slot) : LOG_COUNT(slot);
+                press_button(addr, value);
+
+                boot();
+                int want = presses % 100;
+                if (write == 1 && value == seq)
+                    want = (presses+1) % 100;
+                if (coin_count != want) {
+                    printf("Torn write after %d presses at address %d with "
+                        "value 0x%02X: recovered %d, want %d\n",
+                        presses, addr, value, coin_count, want);
+                    return -1;
+                }
+
+                for (int scan = 1; scan <= LOG_SLOTS+1; scan++)
+                    press_button(NO_TEAR, 0);
+                boot();
+                want = (want + LOG_SLOTS+1) % 100;
+                if (coin_count != want) {
+                    printf("Logging after torn write after %d presses at "
+                        "address %d with value 0x%02X: recovered %d, want %d\n",
+                        presses, addr, value, coin_count, want);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    printf("Torn writes: recovered after every write and value\n");
+    return 0;
+}
+
+
+// Log many presses, losing power at random points, and check that the count
+// is always recovered and that the writes are spread evenly over all cells.
+int check_endurance() {
+    long press;
+    int want = 0;
+    int losses = 0;
+
+    log_erase();
+    for (press = 0; press < NUM_PRESSES; press++) {
+        if (next_rand() % LOSS_PERIOD != 0) {
+            press_button(NO_TEAR, 0);
+            want = (want+1) % 100;
+            continue;
+        }
+
+        // Lose power during one of the two writes, or between presses
+        int addr = NO_TEAR;
+        uint8_t value = next_rand();
+        switch (next_rand() % 3) {
+        case 0: addr = LOG_COUNT((log_slot+1) % LOG_SLOTS); break;
+        case 1: addr = LOG_SEQ((log_slot+1) % LOG_SLOTS); break;
+        }
+        uint8_t seq = log_seq+1;
+        if (press_button(addr, value) ||
+            (addr == LOG_SEQ(log_slot) && value == seq))
+            want = (want+1) % 100;
+        losses++;
+
+        boot();
+        if (coin_count != want) {
+            printf("Power loss at press %ld: recovered %d, want %d\n",
+                press, coin_count, want);
+            return -1;
+        }
+    }
+
+    uint64_t min_wear = wear[0], max_wear = wear[0];
+    for (int scan = 0; scan < EEPROM_SIZE; scan++) {
+        if (wear[scan] < min_wear)
+            min_wear = wear[scan];
+        if (wear[scan] > max_wear)
+            max_wear = wear[scan];
+    }
+    if (max_wear > NUM_PRESSES/LOG_SLOTS + NUM_PRESSES/LOG_SLOTS/100) {
+        printf("Uneven wear: %llu writes to one cell for %d presses\n",
+            (unsigned long long)max_wear, NUM_PRESSES);
+        return -1;
+    }
+
+    printf("Endurance: %d presses with %d power losses\n    ",
+        NUM_PRESSES, losses);
+    printf("Writes per cell: %llu to %llu\n    ",
+        (unsigned long long)min_wear, (unsigned long long)max_wear);
+    printf("Rated lifetime: %llu presses\n",
+        (unsigned long long)EEPROM_ENDURANCE*NUM_PRESSES/max_wear);
+    return 0;
+}
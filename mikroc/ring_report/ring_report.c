@@ -0,0 +1,172 @@
+// Copyright 2009, Joe Tsai. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE.md file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+
+/* Helper macros */
+#define FUNC_RETURN(fn, rc) { fn(); return rc; }
+#define FUNC_PRINT_RETURN(fn, st, rc) { fn(); printf(st); return rc; }
+#define NUM_SOUNDS 6
+#define TM_SYNC 0xA5
+#define TICK_NS 800 // Timer1 period on the door ringer
+
+
+/* Struct definitions */
+typedef struct __attribute__((packed)) {
+    uint16_t boots;
+    uint16_t rings[NUM_SOUNDS];
+    uint16_t preempts;
+    uint16_t dropped;
+    uint16_t overruns;
+    uint16_t wake_last;
+    uint16_t wake_max;
+} Telemetry;
+
+typedef struct {
+    uint64_t rings[NUM_SOUNDS];
+    uint64_t preempts;
+    uint64_t dropped;
+    uint64_t overruns;
+    uint16_t wake_last;
+    uint16_t wake_max;
+    size_t   num_frames;
+    size_t   num_errors;
+    size_t   num_resets;
+} Report;
+
+
+/* Global constants */
+const char help_msg[] = (
+    "This program will decode the telemetry frames sent by the door ringer\n"
+    "and print a report that totals the counters across all frames. Frames\n"
+    "are read from the given capture file, or from stdin if none is given.\n\n"
+);
+const char* sound_names[NUM_SOUNDS] = {
+    "COIN", "COIN_1UP", "COIN_MUSHROOM", "ITS_MARIO", "OUTTA_TIME", "DOWN_PIPE",
+};
+
+
+int read_frame(FILE* in, Telemetry* tm);
+void report_add(Report* rp, Telemetry* prev, Telemetry* tm);
+void report_print(Report* rp);
+
+
+int main(int argc, char* argv[]) {
+    FILE* in = stdin;
+    void ret_func() {
+        if (in != NULL && in != stdin)
+            fclose(in);
+    }
+
+    if (argc > 2)
+        FUNC_PRINT_RETURN(ret_func, help_msg, -1);
+    if (argc == 2) {
+        in = fopen(argv[1], "rb");
+        if (in == NULL)
+            FUNC_PRINT_RETURN(ret_func, "Could not open capture file\n", -1);
+    }
+
+    // Accumulate every frame into the report
+    Report rp;
+    Telemetry prev, tm;
+    memset(&rp, 0, sizeof(rp));
+    memset(&prev, 0, sizeof(prev));
+    while (true) {
+        int rc = read_frame(in, &tm);
+        if (rc < 0)
+            break;
+        if (rc > 0) {
+            rp.num_errors++;
+            continue;
+        }
+        report_add(&rp, &prev, &tm);
+        prev = tm;
+    }
+    report_print(&rp);
+
+    FUNC_RETURN(ret_func, 0);
+}
+
+
+// Read the next frame from the capture. Bytes before the sync byte are
+// skipped. Returns 0 on success, 1 if the frame is malformed, and -1 at the
+// end of the capture.
+int read_frame(FILE* in, Telemetry* tm) {
+    int c;
+    do {
+        c = fgetc(in);
+        if (c == EOF)
+            return -1;
+    } while (c != TM_SYNC);
+
+    int length = fgetc(in);
+    if (length == EOF)
+        return -1;
+    if (length != sizeof(Telemetry))
+        return 1;
+
+    uint8_t buf[sizeof(Telemetry)+1];
+    if (fread(buf, sizeof(buf), 1, in) != 1)
+        return -1;
+
+    uint8_t checksum = length;
+    for (int scan = 0; scan < sizeof(buf); scan++)
+        checksum += buf[scan];
+    if (checksum != 0)
+        return 1;
+
+    memcpy(tm, buf, sizeof(Telemetry));
+    return 0;
+}
+
+
+// Add the counts since the previous frame to the report. The counters on
+// the ringer are 16-bit and may wrap, so differences are taken modulo 2^16.
+// The counters start from zero whenever the ringer boots, which is told
+// apart by the boot count in the frame.
+void report_add(Report* rp, Telemetry* prev, Telemetry* tm) {
+    if (rp->num_frames == 0 || tm->boots != prev->boots) {
+        if (rp->num_frames > 0)
+            rp->num_resets++;
+        memset(prev, 0, sizeof(Telemetry));
+    }
+
+    for (int scan = 0; scan < NUM_SOUNDS; scan++)
+        rp->rings[scan] += (uint16_t)(tm->rings[scan] - prev->rings[scan]);
+    rp->preempts += (uint16_t)(tm->preempts - prev->preempts);
+    rp->dropped += (uint16_t)(tm->dropped - prev->dropped);
+    rp->overruns += (uint16_t)(tm->overruns - prev->overruns);
+    rp->wake_last = tm->wake_last;
+    if (tm->wake_max > rp->wake_max)
+        rp->wake_max = tm->wake_max;
+    rp->num_frames++;
+}
+
+
+// Print the report to stdout.
+void report_print(Report* rp) {
+    printf("Frames decoded: %zu\n", rp->num_frames);
+    printf("Frames invalid: %zu\n", rp->num_errors);
+    printf("Ringer resets:  %zu\n\n", rp->num_resets);
+
+    uint64_t total = 0;
+    printf("Rings:\n");
+    for (int scan = 0; scan < NUM_SOUNDS; scan++) {
+        printf("    %-14s %llu\n",
+            sound_names[scan], (unsigned long long)rp->rings[scan]);
+        total += rp->rings[scan];
+    }
+    printf("    %-14s %llu\n\n", "Total", (unsigned long long)total);
+
+    printf("Preemptions:    %llu\n", (unsigned long long)rp->preempts);
+    printf("Dropped bytes:  %llu\n", (unsigned long long)rp->dropped);
+    printf("Overruns:       %llu\n", (unsigned long long)rp->overruns);
+    printf("Last wake time: %u us\n", rp->wake_last * TICK_NS / 1000);
+    printf("Max wake time:  %u us\n", rp->wake_max * TICK_NS / 1000);
+}